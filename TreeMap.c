@@ -4,14 +4,102 @@
 // the data structure, the tree can be copied to arbitrary memory segments without problems and can also be used for
 // resizable shared memory implementations, where the base-address might change after resizing.
 //
+#define _GNU_SOURCE // mremap()
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include "TreeMap.h"
 
+/*
+ * Stream format of tm_export()/tm_import(). All integers are stored little-endian:
+ *   header:  "PFTM" | version (u32) | value_size (u64) | number of entries (u64)
+ *   entry:   key length (u8) | key (without terminating \0) | value (value_size bytes)
+ *   trailer: FNV-1a checksum (u32) over header and all entries
+ * Entries are written in ascending key order, which allows to rebuild a balanced tree in O(n) when loading.
+ */
+#define TM_STREAM_MAGIC "PFTM"
+#define TM_STREAM_VERSION 1
+
+typedef struct IStreamWriter {
+    tm_writeCallback write_cb;
+    void *ctx;
+    unsigned char buf[TM_STREAM_BUFSIZE];
+    size_t fill;
+    uint32_t checksum;
+    int error;
+} IStreamWriter;
+
+typedef struct IStreamReader {
+    tm_readCallback read_cb;
+    void *ctx;
+    unsigned char buf[TM_STREAM_BUFSIZE];
+    size_t pos;
+    size_t fill;
+    uint32_t checksum;
+    int error;
+    int first; // no key was read yet
+    char prevKey[MAX_KEYLENGTH + 1];
+} IStreamReader;
+
+static uint32_t Ichecksum(uint32_t h, const unsigned char *data, size_t len);
+
+static void IstreamPut(IStreamWriter *w, const void *data, size_t len);
+
+static void IstreamPutUint(IStreamWriter *w, uint64_t v, int numBytes);
+
+static int IstreamFlush(IStreamWriter *w);
+
+static void IexportTreeNodes(TreeMap *tm, UL n, IStreamWriter *w);
+
+static int IstreamGet(IStreamReader *r, void *data, size_t len);
+
+static uint64_t IstreamGetUint(IStreamReader *r, int numBytes);
+
+static UL IimportTreeNodes(TreeMap *tm, IStreamReader *r, UL count);
+
+static ssize_t IfdWrite(void *ctx, const void *buf, size_t len);
+
+static ssize_t IfdRead(void *ctx, void *buf, size_t len);
+
+/*
+ * Shared state of the threads of tm_parallelForEach()/tm_parallelReduce(). The tree is split into disjoint sub-trees
+ * (tasks), which are picked up one after another by the threads.
+ */
+typedef struct IParallelJob {
+    TreeMap *tm;
+    tm_forEachCallback each;
+    tm_reduceCallback reduce;
+    void *ctx;
+    UL *tasks;
+    int numTasks;
+    int nextTask;
+    pthread_mutex_t lock;
+} IParallelJob;
+
+typedef struct IParallelWorker {
+    IParallelJob *job;
+    void *acc;
+    pthread_t thread;
+    int started;
+} IParallelWorker;
+
+static void IvisitSubTree(IParallelJob *job, UL n, void *acc);
+
+static void IcollectTasks(IParallelJob *job, UL n, int depth, void *acc);
+
+static void *IparallelWorker(void *arg);
+
+static int IrunParallel(TreeMap *tm, tm_forEachCallback each, tm_reduceCallback reduce, tm_combineCallback combine,
+                        void *acc, size_t accSize, void *ctx, int numThreads);
+
 int tm_poolExhausted(TreeMap *tm) {
     // the first node is always used as entry point into the Tree-Node pool (right) and root node of the actual tree (left)
-    return tm->treeNodePool[0].right == 0;
+    return tm->treeNodePool[0].right == 0 && IgetPoolInfo(tm, TM_INFO_UNTOUCHED) == 0;
 }
 
 /*
@@ -26,6 +114,9 @@ size_t tm_estimateRequiredBytes(size_t nodeSize, int numNodes) {
 void tm_initTreeNodePool(TreeMap *tm, void *ptr, size_t size, size_t sizeSingleNode) {
     tm->treeNodePool = ptr;
     tm->value_size = sizeSingleNode;
+    tm->alloc_size = 0; // not created with tm_createTreeNodePool()
+    tm->alloc_flags = 0;
+    tm->numa_node = 0;
     memset(tm->treeNodePool, 0, size); // zero everyting
 
     tm->size_treeNodePool = (unsigned int) (size / sizeOfNode(tm));
@@ -82,31 +173,141 @@ void tm_resizeTreeNodePool(TreeMap *tm, void *new_ptr, size_t new_size, int re_i
     if(re_init) {
         // First Null the new memory area
         memset(new_ptr + old_size, 0, diff);
-        for (unsigned int i = tm->size_treeNodePool; i < tm->size_treeNodePool + num_new_nodes - 1; i++)
-            ab(tm, i)->right = i + 1;
 
-        // Now put these new nodes into the pool...
-        // Cut the list in the front and squeeze the new list into the gap
-        // First, append the old pool list to the end of the new list
-        ab(tm, tm->size_treeNodePool + num_new_nodes - 1)->right = tm->treeNodePool[0].right;
+        // The untouched nodes (see tm_clear()) only reach up to the old end of the pool, so link them into the pool
+        // explicitly. Otherwise IgetNodeFromPool() would hand out the new nodes a second time.
+        UL untouched = IgetPoolInfo(tm, TM_INFO_UNTOUCHED);
+        if (untouched != 0) {
+            IlinkFreeNodes(tm, untouched, IpoolEnd(tm));
+            IsetPoolInfo(tm, TM_INFO_UNTOUCHED, 0);
+        }
 
-        // Then, add the list to the front of the pool
-        tm->treeNodePool[0].right = tm->size_treeNodePool;
+        if (IhashEnabled(tm)) {
+            // The hash index always occupies the last nodes of the pool and grows with it. Since the table needs less
+            // than one node per new node, the new table starts behind the old one. All nodes between both become free.
+            UL oldStart = IgetPoolInfo(tm, TM_INFO_HASH_START);
+            UL newSize = tm->size_treeNodePool + num_new_nodes;
+            UL newStart = newSize - IhashTableNodes(tm, newSize);
+            if (newStart < oldStart)
+                newStart = oldStart;
+            memset(ab(tm, oldStart), 0, (tm->size_treeNodePool - oldStart) * sizeOfNode(tm));
+            IlinkFreeNodes(tm, oldStart, newStart);
+            IsetPoolInfo(tm, TM_INFO_HASH_START, newStart);
+            IsetPoolInfo(tm, TM_INFO_HASH_NODES, newSize - newStart);
+        } else {
+            // Now put the new nodes into the pool
+            IlinkFreeNodes(tm, tm->size_treeNodePool, tm->size_treeNodePool + num_new_nodes);
+        }
     }
     // This is the new size of our tree-node pool
     tm->size_treeNodePool += num_new_nodes;
     printf("The tree-node pool has now %d elements", tm->size_treeNodePool);
+
+    // The hash index is larger now, so all entries have to be placed in the new table again
+    if (re_init && IhashEnabled(tm))
+        IhashRebuild(tm);
+}
+
+/*
+ * Instead of obtaining the memory for the pool from malloc() or a SHM, let the library map it. Depending on flags
+ * (TM_POOL_*), the pool is backed by huge pages, which reduces the number of TLB misses for random accesses into large
+ * pools, and/or its memory is bound to (interleaved over) NUMA nodes. size is rounded up to a multiple of
+ * TM_HUGE_PAGE_SIZE. Returns the address of the pool (which is initialized already) or NULL on error.
+ * The pool is a private anonymous mapping and cannot be shared with other processes (child processes only get a
+ * copy-on-write view). To share a tree, place it in a SHM and use tm_initTreeNodePool() instead.
+ */
+void *tm_createTreeNodePool(TreeMap *tm, size_t size, size_t sizeSingleNode, int flags, int numaNode) {
+    size = IroundToHugePages(size);
+    void *ptr = ImapPool(size, &flags);
+    if (ptr == NULL)
+        return NULL;
+    IadvisePool(ptr, size, flags, numaNode); // before the memory is touched the first time in tm_initTreeNodePool()
+    tm_initTreeNodePool(tm, ptr, size, sizeSingleNode);
+    tm->alloc_size = size;
+    tm->alloc_flags = flags;
+    tm->numa_node = numaNode;
+    return ptr;
+}
+
+/*
+ * Grow a pool created with tm_createTreeNodePool() to (at least) new_size bytes. The pool might be moved to another
+ * address, which is handled by tm_resizeTreeNodePool(). Returns the new address of the pool or NULL on error (in which
+ * case the old pool is still valid).
+ */
+void *tm_growTreeNodePool(TreeMap *tm, size_t new_size) {
+    if (tm->alloc_size == 0) {
+        fprintf(stderr, "Pool was not created with tm_createTreeNodePool(): %s, line %d\n", __FILE__, __LINE__);
+        return NULL;
+    }
+    new_size = IroundToHugePages(new_size);
+    if (new_size <= tm->alloc_size) {
+        printf("Reducing the size of the pool not supported yet!");
+        return tm->treeNodePool;
+    }
+    void *old_ptr = tm->treeNodePool;
+    void *new_ptr = MAP_FAILED;
+#ifdef MREMAP_MAYMOVE
+    // The kernel refuses to expand mappings of explicit huge pages, so these are always copied below
+    if (!(tm->alloc_flags & TM_POOL_HUGE_PAGES)) {
+        new_ptr = mremap(old_ptr, tm->alloc_size, new_size, MREMAP_MAYMOVE);
+        // Only the new part of the pool has to be advised, the old part keeps its settings
+        if (new_ptr != MAP_FAILED)
+            IadvisePool((char *) new_ptr + tm->alloc_size, new_size - tm->alloc_size, tm->alloc_flags, tm->numa_node);
+    }
+#endif
+    if (new_ptr == MAP_FAILED) {
+        // Map a new region and copy the pool
+        int flags = tm->alloc_flags;
+        new_ptr = ImapPool(new_size, &flags);
+        if (new_ptr == NULL) {
+            fprintf(stderr, "Could not grow the pool: %s, line %d\n", __FILE__, __LINE__);
+            return NULL;
+        }
+        IadvisePool(new_ptr, new_size, flags, tm->numa_node);
+        memcpy(new_ptr, old_ptr, tm->alloc_size);
+        munmap(old_ptr, tm->alloc_size);
+        tm->alloc_flags = flags;
+    }
+    tm->alloc_size = new_size;
+    tm_resizeTreeNodePool(tm, new_ptr, new_size, 1);
+    return new_ptr;
+}
+
+void tm_destroyTreeNodePool(TreeMap *tm) {
+    if (tm->alloc_size == 0) {
+        fprintf(stderr, "Pool was not created with tm_createTreeNodePool(): %s, line %d\n", __FILE__, __LINE__);
+        return;
+    }
+    munmap(tm->treeNodePool, tm->alloc_size);
+    tm->treeNodePool = NULL;
+    tm->size_treeNodePool = 0;
+    tm->alloc_size = 0;
 }
 
 /*
  * Find a key in the tree and return the corresponding value. If not found, return NULL.
  */
 void *tm_getValue(TreeMap *tm, char *key, void *value) {
+    if (IhashEnabled(tm)) {
+        UL n = IhashFind(tm, key);
+        if (n == 0)
+            return NULL;
+        memcpy(value, &(ab(tm, n)->value), tm->value_size);
+        return value;
+    }
     UL *root = &tm->treeNodePool[0].left;
     return IgetTreeNodeValue(tm, *root, key, value);
 }
 
 void tm_insert(TreeMap *tm, char *key, void *value) {
+    if (IhashEnabled(tm)) {
+        // If the key exists already, only the value has to be replaced and the tree does not change
+        UL n = IhashFind(tm, key);
+        if (n != 0) {
+            memcpy(&(ab(tm, n)->value), value, tm->value_size);
+            return;
+        }
+    }
     // the first node in the pool contains the root node on the left branch
     // (The right branch contains the currently available pool of free nodes
     if (tm->treeNodePool[0].left == 0) { // if the tree is empty
@@ -118,6 +319,9 @@ void tm_insert(TreeMap *tm, char *key, void *value) {
 }
 
 void tm_delete(TreeMap *tm, char *key) {
+    // Nodes moved around during the deletion are updated in the hash index by IdeleteTreeNode
+    if (IhashEnabled(tm) && !IhashRemove(tm, key))
+        return; // key is not in the tree
     UL *root = &tm->treeNodePool[0].left;
     *root = IdeleteTreeNode(tm, *root, key);
 }
@@ -140,6 +344,187 @@ int tm_getKeys(TreeMap *tm, char (*keys)[MAX_KEYLENGTH]) {
     return IgetKeys(tm, *root, keys, i);
 }
 
+/*
+ * Remove all entries from the tree in O(1): The nodes are not linked into the pool again, but all nodes are marked as
+ * untouched, so that IgetNodeFromPool() hands them out one after another. Only if the hash index is enabled, its slots
+ * have to be cleared, which takes O(size of the index).
+ */
+void tm_clear(TreeMap *tm) {
+    tm->treeNodePool[0].left = 0;
+    tm->treeNodePool[0].right = 0;
+    IsetPoolInfo(tm, TM_INFO_UNTOUCHED, IpoolEnd(tm) > 1 ? 1 : 0);
+    if (IhashEnabled(tm))
+        IhashRebuild(tm);
+}
+
+/*
+ * Delete all keys k with from <= k <= to. Instead of deleting (and rebalancing) key by key, the range is split off the
+ * tree and the remaining two parts are joined again, which requires only O(log n) rebalancing steps.
+ * Returns the number of deleted entries.
+ */
+int tm_deleteRange(TreeMap *tm, char *from, char *to) {
+    UL *root = &tm->treeNodePool[0].left;
+    UL left, middle, right;
+    Isplit(tm, *root, from, 0, &left, &right);
+    Isplit(tm, right, to, 1, &middle, &right);
+    *root = IjoinTrees(tm, left, right);
+    return IremoveSubTree(tm, middle);
+}
+
+/*
+ * Call each for all entries of the tree, using numThreads threads (including the calling thread). The order in which
+ * the entries are visited is undefined. Returns 0 on success, -1 on error.
+ */
+int tm_parallelForEach(TreeMap *tm, tm_forEachCallback each, void *ctx, int numThreads) {
+    return IrunParallel(tm, each, NULL, NULL, NULL, 0, ctx, numThreads);
+}
+
+/*
+ * Aggregate over all entries of the tree, using numThreads threads (including the calling thread). acc has to contain
+ * the neutral element of the aggregation (e.g., 0 for a sum) and contains the result afterwards. Every thread
+ * accumulates into its own copy of acc, which are merged with combine at the end. Returns 0 on success, -1 on error.
+ */
+int tm_parallelReduce(TreeMap *tm, tm_reduceCallback reduce, tm_combineCallback combine, void *acc, size_t accSize,
+                      void *ctx, int numThreads) {
+    return IrunParallel(tm, NULL, reduce, combine, acc, accSize, ctx, numThreads);
+}
+
+/*
+ * Maintain an additional hash index (open addressing, linear probing) for the keys of the tree, so that tm_getValue()
+ * does not have to walk down the tree anymore. The tree itself is still used for all ordered operations.
+ * The index is stored in the last nodes of the pool (about TM_HASH_SLOTS_PER_NODE * sizeof(UL) bytes per node), which
+ * are taken out of the pool. So the index is moved/shared together with the pool and grows with
+ * tm_resizeTreeNodePool(). Entries of the tree stored in these nodes are moved to other free nodes first.
+ * Returns 0 on success or -1, if the pool does not have enough free nodes for the index.
+ */
+int tm_enableHashIndex(TreeMap *tm) {
+    if (IhashEnabled(tm))
+        return 0;
+    UL tableNodes = IhashTableNodes(tm, tm->size_treeNodePool);
+    UL start = tm->size_treeNodePool - tableNodes;
+    if (tableNodes >= tm->size_treeNodePool || (UL) tm_countNodes(tm) > start - 1) {
+        fprintf(stderr, "Not enough free nodes in the pool for the hash index: %s, line %d\n", __FILE__, __LINE__);
+        return -1;
+    }
+    if (IreserveNodes(tm, start) != 0)
+        return -1;
+    IsetPoolInfo(tm, TM_INFO_HASH_START, start);
+    IsetPoolInfo(tm, TM_INFO_HASH_NODES, tableNodes);
+    tm->treeNodePool[0].height |= TM_FLAG_HASH_INDEX;
+    IhashRebuild(tm);
+    return 0;
+}
+
+/*
+ * Drop the hash index and give its nodes back to the pool
+ */
+void tm_disableHashIndex(TreeMap *tm) {
+    if (!IhashEnabled(tm))
+        return;
+    UL start = IgetPoolInfo(tm, TM_INFO_HASH_START);
+    tm->treeNodePool[0].height &= ~TM_FLAG_HASH_INDEX;
+    memset(ab(tm, start), 0, (tm->size_treeNodePool - start) * sizeOfNode(tm));
+    // If there are untouched nodes, they reach up to the index and now automatically include its nodes
+    if (IgetPoolInfo(tm, TM_INFO_UNTOUCHED) == 0)
+        IlinkFreeNodes(tm, start, tm->size_treeNodePool);
+    IsetPoolInfo(tm, TM_INFO_HASH_START, 0);
+    IsetPoolInfo(tm, TM_INFO_HASH_NODES, 0);
+}
+
+/*
+ * Write all entries of the tree in a compact format (see TM_STREAM_MAGIC) to a user-defined sink. In contrast to
+ * copying the whole pool, free nodes are not written. Returns the number of written entries or -1 on error.
+ */
+int tm_export(TreeMap *tm, tm_writeCallback write_cb, void *ctx) {
+    IStreamWriter *w = malloc(sizeof(IStreamWriter));
+    if (w == NULL) {
+        fprintf(stderr, "Could not allocate stream buffer: %s, line %d\n", __FILE__, __LINE__);
+        return -1;
+    }
+    w->write_cb = write_cb;
+    w->ctx = ctx;
+    w->fill = 0;
+    w->checksum = Ichecksum(0, NULL, 0);
+    w->error = 0;
+
+    int count = tm_countNodes(tm);
+    IstreamPut(w, TM_STREAM_MAGIC, 4);
+    IstreamPutUint(w, TM_STREAM_VERSION, 4);
+    IstreamPutUint(w, tm->value_size, 8);
+    IstreamPutUint(w, (uint64_t) count, 8);
+
+    IexportTreeNodes(tm, tm->treeNodePool[0].left, w);
+
+    IstreamPutUint(w, w->checksum, 4);
+    int error = IstreamFlush(w);
+    free(w);
+    if (error) {
+        fprintf(stderr, "Could not export the tree: %s, line %d\n", __FILE__, __LINE__);
+        return -1;
+    }
+    return count;
+}
+
+int tm_exportToFd(TreeMap *tm, int fd) {
+    return tm_export(tm, IfdWrite, &fd);
+}
+
+/*
+ * Load entries written by tm_export() into an empty tree. Since the entries arrive sorted, a perfectly balanced tree
+ * is built directly in O(n) without any rotations. The pool must have enough free nodes for all entries.
+ * Returns the number of loaded entries or -1 on error (in which case the tree is left empty).
+ */
+int tm_import(TreeMap *tm, tm_readCallback read_cb, void *ctx) {
+    if (tm->treeNodePool[0].left != 0) {
+        fprintf(stderr, "Can only import into an empty tree: %s, line %d\n", __FILE__, __LINE__);
+        return -1;
+    }
+    IStreamReader *r = malloc(sizeof(IStreamReader));
+    if (r == NULL) {
+        fprintf(stderr, "Could not allocate stream buffer: %s, line %d\n", __FILE__, __LINE__);
+        return -1;
+    }
+    r->read_cb = read_cb;
+    r->ctx = ctx;
+    r->pos = r->fill = 0;
+    r->checksum = Ichecksum(0, NULL, 0);
+    r->error = 0;
+    r->first = 1;
+
+    int ret = -1;
+    char magic[4];
+    IstreamGet(r, magic, 4);
+    uint64_t version = IstreamGetUint(r, 4);
+    uint64_t value_size = IstreamGetUint(r, 8);
+    uint64_t count = IstreamGetUint(r, 8);
+    if (r->error || memcmp(magic, TM_STREAM_MAGIC, 4) != 0 || version != TM_STREAM_VERSION) {
+        fprintf(stderr, "Invalid stream header: %s, line %d\n", __FILE__, __LINE__);
+    } else if (value_size != tm->value_size) {
+        fprintf(stderr, "Value size of the stream does not match the tree: %s, line %d\n", __FILE__, __LINE__);
+    } else if (count > IpoolEnd(tm) - 1) { // -1, because the first node cannot be really used
+        fprintf(stderr, "Not enough nodes in the pool for %lu entries: %s, line %d\n", (UL) count, __FILE__, __LINE__);
+    } else {
+        UL root = IimportTreeNodes(tm, r, (UL) count);
+        uint32_t expected = r->checksum;
+        uint32_t checksum = (uint32_t) IstreamGetUint(r, 4);
+        if (r->error || checksum != expected) {
+            fprintf(stderr, "Corrupt or truncated stream: %s, line %d\n", __FILE__, __LINE__);
+            IfreeSubTree(tm, root);
+        } else {
+            tm->treeNodePool[0].left = root;
+            if (IhashEnabled(tm))
+                IhashInsertSubTree(tm, root);
+            ret = (int) count;
+        }
+    }
+    free(r);
+    return ret;
+}
+
+int tm_importFromFd(TreeMap *tm, int fd) {
+    return tm_import(tm, IfdRead, &fd);
+}
+
 
 
 // ----------------------------------------------------------------------------------------------------------------
@@ -157,10 +542,54 @@ static TreeNode *ab(TreeMap *tm, UL rel) {
     return (rel >= 0 ? ((void *) tm->treeNodePool) + sizeOfNode(tm) * rel : NULL);
 }
 
+/*
+ * Read/write one of the TM_INFO_* fields stored in the key of the first node. Nodes starting from TM_INFO_UNTOUCHED up
+ * to the end of the pool (or the hash index) are free, but not linked into the pool (see tm_clear()).
+ */
+static UL IgetPoolInfo(TreeMap *tm, int field) {
+    uint32_t value;
+    memcpy(&value, tm->treeNodePool[0].key + field * sizeof(uint32_t), sizeof(uint32_t));
+    return value;
+}
+
+static void IsetPoolInfo(TreeMap *tm, int field, UL value) {
+    uint32_t v = (uint32_t) value;
+    memcpy(tm->treeNodePool[0].key + field * sizeof(uint32_t), &v, sizeof(uint32_t));
+}
+
+/*
+ * The nodes behind this index are not available for the tree, since they contain the hash index
+ */
+static UL IpoolEnd(TreeMap *tm) {
+    return IhashEnabled(tm) ? IgetPoolInfo(tm, TM_INFO_HASH_START) : tm->size_treeNodePool;
+}
+
+/*
+ * Put the nodes from, ..., to-1 into the pool. The nodes do not have to be initialized.
+ */
+static void IlinkFreeNodes(TreeMap *tm, UL from, UL to) {
+    if (from >= to)
+        return;
+    for (UL i = from; i < to - 1; i++)
+        ab(tm, i)->right = i + 1;
+
+    // Cut the list in the front and squeeze the new list into the gap
+    // First, append the old pool list to the end of the new list
+    ab(tm, to - 1)->right = tm->treeNodePool[0].right;
+
+    // Then, add the list to the front of the pool
+    tm->treeNodePool[0].right = from;
+}
+
 static UL IgetNodeFromPool(TreeMap *tm) {
     if (tm->treeNodePool[0].right == 0) {
-        printf( "Node Pool exhausted");
-        return 0;
+        UL untouched = IgetPoolInfo(tm, TM_INFO_UNTOUCHED);
+        if (untouched == 0) {
+            printf( "Node Pool exhausted");
+            return 0;
+        }
+        IsetPoolInfo(tm, TM_INFO_UNTOUCHED, untouched + 1 < IpoolEnd(tm) ? untouched + 1 : 0);
+        return untouched;
     }
 
     UL ret = tm->treeNodePool[0].right;
@@ -179,6 +608,17 @@ static void Ifree_node(TreeMap *tm, UL n) {
     tm->treeNodePool[0].right = n;
 }
 
+/*
+ * Give all nodes of a (sub-) tree back to the pool
+ */
+static void IfreeSubTree(TreeMap *tm, UL n) {
+    if (n == 0)
+        return;
+    IfreeSubTree(tm, ab(tm, n)->left);
+    IfreeSubTree(tm, ab(tm, n)->right);
+    Ifree_node(tm, n);
+}
+
 static UL InewTreeNode(TreeMap *tm, char *key, void *value) {
     if (strlen(key) > MAX_KEYLENGTH) return 0;
     //TreeNode *node = (TreeNode *) malloc(sizeof(TreeNode)); // careful in shm
@@ -192,6 +632,8 @@ static UL InewTreeNode(TreeMap *tm, char *key, void *value) {
     ab(tm, node)->height = 1;
     memcpy(&(ab(tm, node)->value), value, tm->value_size);
     strcpy(ab(tm, node)->key, key);
+    if (IhashEnabled(tm))
+        IhashInsert(tm, node);
     return (node);
 }
 
@@ -354,10 +796,13 @@ static UL IdeleteTreeNode(TreeMap *tm, UL n, char *key) {
             if (tmp == 0) {
                 tmp = n;
                 n = 0;
-            } else // Or we have one child:
+            } else { // Or we have one child:
                 // Overwrite our struct n completely with struct tmp
                 //*ab(tm, n) = *ab(tm, tmp); // this line does not copy the value field, since it is not part of TreeNode
                 memcpy(ab(tm, n), ab(tm, tmp), sizeOfNode(tm));
+                if (IhashEnabled(tm))
+                    IhashRelocate(tm, tmp, n);
+            }
             // Either delete the child (because we copied it to n) or delete the current node (if it didnt have any children)
             Ifree_node(tm, tmp);
         } else { // The node has 2 children
@@ -368,6 +813,8 @@ static UL IdeleteTreeNode(TreeMap *tm, UL n, char *key) {
             // So replace the current node with min
             strcpy(ab(tm, n)->key, ab(tm, min)->key);
             memcpy(&(ab(tm, n)->value), &(ab(tm, min)->value), tm->value_size);
+            if (IhashEnabled(tm))
+                IhashRelocate(tm, min, n);
 
             // Now we have to find min in the right sub-tree again and delete it. We will end up in the if-clause above this otherwise...
             ab(tm, n)->right = IdeleteTreeNode(tm, ab(tm, n)->right, ab(tm, min)->key);
@@ -381,6 +828,583 @@ static UL IdeleteTreeNode(TreeMap *tm, UL n, char *key) {
 }
 
 
+// FNV-1a, used to detect corrupt or truncated streams. Call with data == NULL to obtain the initial value.
+static uint32_t Ichecksum(uint32_t h, const unsigned char *data, size_t len) {
+    if (data == NULL)
+        return 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int IstreamFlush(IStreamWriter *w) {
+    size_t done = 0;
+    while (!w->error && done < w->fill) {
+        ssize_t ret = w->write_cb(w->ctx, w->buf + done, w->fill - done);
+        if (ret <= 0)
+            w->error = 1;
+        else
+            done += ret;
+    }
+    w->fill = 0;
+    return w->error;
+}
+
+static void IstreamPut(IStreamWriter *w, const void *data, size_t len) {
+    const unsigned char *p = data;
+    w->checksum = Ichecksum(w->checksum, p, len);
+    while (!w->error && len > 0) {
+        size_t chunk = TM_STREAM_BUFSIZE - w->fill;
+        if (chunk > len) chunk = len;
+        memcpy(w->buf + w->fill, p, chunk);
+        w->fill += chunk;
+        p += chunk;
+        len -= chunk;
+        if (w->fill == TM_STREAM_BUFSIZE)
+            IstreamFlush(w);
+    }
+}
+
+static void IstreamPutUint(IStreamWriter *w, uint64_t v, int numBytes) {
+    unsigned char bytes[8];
+    for (int i = 0; i < numBytes; i++)
+        bytes[i] = (unsigned char) (v >> (8 * i));
+    IstreamPut(w, bytes, numBytes);
+}
+
+/*
+ * In-order traversal, so that the entries end up sorted in the stream
+ */
+static void IexportTreeNodes(TreeMap *tm, UL n, IStreamWriter *w) {
+    if (n == 0 || w->error)
+        return;
+    IexportTreeNodes(tm, ab(tm, n)->left, w);
+    size_t len = strlen(ab(tm, n)->key);
+    IstreamPutUint(w, len, 1);
+    IstreamPut(w, ab(tm, n)->key, len);
+    IstreamPut(w, &(ab(tm, n)->value), tm->value_size);
+    IexportTreeNodes(tm, ab(tm, n)->right, w);
+}
+
+/*
+ * Read exactly len bytes. Returns 0 on success, otherwise the error flag of the reader is set.
+ */
+static int IstreamGet(IStreamReader *r, void *data, size_t len) {
+    unsigned char *p = data;
+    while (!r->error && len > 0) {
+        if (r->pos == r->fill) {
+            ssize_t ret = r->read_cb(r->ctx, r->buf, TM_STREAM_BUFSIZE);
+            if (ret <= 0) { // unexpected end of the stream or error
+                r->error = 1;
+                break;
+            }
+            r->pos = 0;
+            r->fill = (size_t) ret;
+        }
+        size_t chunk = r->fill - r->pos;
+        if (chunk > len) chunk = len;
+        memcpy(p, r->buf + r->pos, chunk);
+        r->checksum = Ichecksum(r->checksum, p, chunk);
+        r->pos += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+    return r->error;
+}
+
+static uint64_t IstreamGetUint(IStreamReader *r, int numBytes) {
+    unsigned char bytes[8];
+    uint64_t v = 0;
+    if (IstreamGet(r, bytes, numBytes) != 0)
+        return 0;
+    for (int i = 0; i < numBytes; i++)
+        v |= (uint64_t) bytes[i] << (8 * i);
+    return v;
+}
+
+/*
+ * Build a balanced tree out of the next count (sorted) entries of the stream: the middle entry becomes the root,
+ * the entries before it the left and the entries after it the right sub-tree. On error, all nodes taken from the
+ * pool are returned again and 0 is returned.
+ */
+static UL IimportTreeNodes(TreeMap *tm, IStreamReader *r, UL count) {
+    if (count == 0 || r->error)
+        return 0;
+    UL left = IimportTreeNodes(tm, r, count / 2);
+    if (r->error)
+        return 0;
+
+    UL n = IgetNodeFromPool(tm);
+    if (n == 0) {
+        r->error = 1;
+        IfreeSubTree(tm, left);
+        return 0;
+    }
+    size_t len = IstreamGetUint(r, 1);
+    if (len > MAX_KEYLENGTH)
+        r->error = 1; // do not touch the node, the key would not fit into it
+    if (IstreamGet(r, ab(tm, n)->key, len) == 0)
+        ab(tm, n)->key[len] = '\0';
+    IstreamGet(r, &(ab(tm, n)->value), tm->value_size);
+    // Keys have to be strictly ascending, otherwise the stream does not describe a valid search tree
+    if (!r->error && !r->first && strcmp(r->prevKey, ab(tm, n)->key) >= 0)
+        r->error = 1;
+    if (r->error) {
+        Ifree_node(tm, n);
+        IfreeSubTree(tm, left);
+        return 0;
+    }
+    strcpy(r->prevKey, ab(tm, n)->key);
+    r->first = 0;
+
+    UL right = IimportTreeNodes(tm, r, count - count / 2 - 1);
+    if (r->error) {
+        Ifree_node(tm, n);
+        IfreeSubTree(tm, left);
+        return 0;
+    }
+    ab(tm, n)->left = left;
+    ab(tm, n)->right = right;
+    ab(tm, n)->height = IgetTreeNodeHeight(tm, n);
+    return n;
+}
+
+static int IhashEnabled(TreeMap *tm) {
+    return tm->treeNodePool[0].height & TM_FLAG_HASH_INDEX;
+}
+
+/*
+ * Number of nodes required to store the hash index for a pool of numNodes nodes
+ */
+static UL IhashTableNodes(TreeMap *tm, UL numNodes) {
+    return (TM_HASH_SLOTS_PER_NODE * numNodes * sizeof(UL) + sizeOfNode(tm) - 1) / sizeOfNode(tm);
+}
+
+static UL IhashNumSlots(TreeMap *tm) {
+    return IgetPoolInfo(tm, TM_INFO_HASH_NODES) * sizeOfNode(tm) / sizeof(UL);
+}
+
+/*
+ * The slots of the hash index are stored one after another in the nodes starting at TM_INFO_HASH_START. Each slot
+ * contains the relative address of a node in the tree or 0, if it is empty. Since the size of the nodes is arbitrary,
+ * the slots are not necessarily aligned.
+ */
+static UL IhashGet(TreeMap *tm, UL s) {
+    UL n;
+    memcpy(&n, (char *) ab(tm, IgetPoolInfo(tm, TM_INFO_HASH_START)) + s * sizeof(UL), sizeof(UL));
+    return n;
+}
+
+static void IhashSet(TreeMap *tm, UL s, UL n) {
+    memcpy((char *) ab(tm, IgetPoolInfo(tm, TM_INFO_HASH_START)) + s * sizeof(UL), &n, sizeof(UL));
+}
+
+static UL IhashHome(TreeMap *tm, char *key) {
+    return Ichecksum(Ichecksum(0, NULL, 0), (unsigned char *) key, strlen(key)) % IhashNumSlots(tm);
+}
+
+/*
+ * Returns the node containing key or 0, if the key is not in the index
+ */
+static UL IhashFind(TreeMap *tm, char *key) {
+    UL numSlots = IhashNumSlots(tm);
+    for (UL s = IhashHome(tm, key);; s = (s + 1) % numSlots) {
+        UL n = IhashGet(tm, s);
+        if (n == 0 || strcmp(ab(tm, n)->key, key) == 0)
+            return n;
+    }
+}
+
+static void IhashInsert(TreeMap *tm, UL n) {
+    UL numSlots = IhashNumSlots(tm);
+    UL s = IhashHome(tm, ab(tm, n)->key);
+    while (IhashGet(tm, s) != 0)
+        s = (s + 1) % numSlots;
+    IhashSet(tm, s, n);
+}
+
+/*
+ * Remove key from the index. Instead of leaving tombstones, the following entries of the probe sequence are moved
+ * back into the gap. Returns 0, if the key was not found.
+ */
+static int IhashRemove(TreeMap *tm, char *key) {
+    UL numSlots = IhashNumSlots(tm);
+    UL gap = IhashHome(tm, key);
+    while (IhashGet(tm, gap) != 0 && strcmp(ab(tm, IhashGet(tm, gap))->key, key) != 0)
+        gap = (gap + 1) % numSlots;
+    if (IhashGet(tm, gap) == 0)
+        return 0;
+
+    for (UL s = (gap + 1) % numSlots; IhashGet(tm, s) != 0; s = (s + 1) % numSlots) {
+        UL home = IhashHome(tm, ab(tm, IhashGet(tm, s))->key);
+        // Only move the entry, if its home slot does not lie (cyclically) between the gap and its current slot
+        int between = gap <= s ? (home > gap && home <= s) : (home > gap || home <= s);
+        if (!between) {
+            IhashSet(tm, gap, IhashGet(tm, s));
+            gap = s;
+        }
+    }
+    IhashSet(tm, gap, 0);
+    return 1;
+}
+
+/*
+ * The content of node from was copied to node to, so the index entry has to follow it
+ */
+static void IhashRelocate(TreeMap *tm, UL from, UL to) {
+    UL numSlots = IhashNumSlots(tm);
+    UL s = IhashHome(tm, ab(tm, to)->key);
+    while (IhashGet(tm, s) != from && IhashGet(tm, s) != 0)
+        s = (s + 1) % numSlots;
+    if (IhashGet(tm, s) == from)
+        IhashSet(tm, s, to);
+}
+
+static void IhashRebuild(TreeMap *tm) {
+    memset(ab(tm, IgetPoolInfo(tm, TM_INFO_HASH_START)), 0, IgetPoolInfo(tm, TM_INFO_HASH_NODES) * sizeOfNode(tm));
+    IhashInsertSubTree(tm, tm->treeNodePool[0].left);
+}
+
+static void IhashInsertSubTree(TreeMap *tm, UL n) {
+    if (n == 0)
+        return;
+    IhashInsert(tm, n);
+    IhashInsertSubTree(tm, ab(tm, n)->left);
+    IhashInsertSubTree(tm, ab(tm, n)->right);
+}
+
+/*
+ * Make sure that no node starting from limit is used: the pool is rebuilt from all free nodes below limit and the
+ * entries of the tree stored behind limit are moved to such nodes. Returns 0 on success, -1 on error.
+ */
+static int IreserveNodes(TreeMap *tm, UL limit) {
+    char *live = calloc(tm->size_treeNodePool, 1);
+    if (live == NULL) {
+        fprintf(stderr, "Could not allocate memory: %s, line %d\n", __FILE__, __LINE__);
+        return -1;
+    }
+    ImarkSubTree(tm, tm->treeNodePool[0].left, live);
+    tm->treeNodePool[0].right = 0;
+    IsetPoolInfo(tm, TM_INFO_UNTOUCHED, 0);
+    for (UL i = limit - 1; i > 0; i--) {
+        if (!live[i])
+            Ifree_node(tm, i);
+    }
+    free(live);
+    tm->treeNodePool[0].left = IrelocateSubTree(tm, tm->treeNodePool[0].left, limit);
+    return 0;
+}
+
+static void ImarkSubTree(TreeMap *tm, UL n, char *live) {
+    if (n == 0)
+        return;
+    live[n] = 1;
+    ImarkSubTree(tm, ab(tm, n)->left, live);
+    ImarkSubTree(tm, ab(tm, n)->right, live);
+}
+
+/*
+ * Move all nodes of the (sub-) tree n, which are stored behind limit, to free nodes. Returns the new address of n.
+ */
+static UL IrelocateSubTree(TreeMap *tm, UL n, UL limit) {
+    if (n == 0)
+        return 0;
+    ab(tm, n)->left = IrelocateSubTree(tm, ab(tm, n)->left, limit);
+    ab(tm, n)->right = IrelocateSubTree(tm, ab(tm, n)->right, limit);
+    if (n < limit)
+        return n;
+    UL m = IgetNodeFromPool(tm); // cannot fail, since the tree fits into the nodes below limit
+    memcpy(ab(tm, m), ab(tm, n), sizeOfNode(tm));
+    return m;
+}
+
+/*
+ * Join the trees l and r (all keys in l are smaller than all keys in r) using node k (with l < k < r) as glue.
+ * The resulting tree is balanced again.
+ */
+static UL Ijoin(TreeMap *tm, UL l, UL k, UL r) {
+    if (Iheight(tm, l) > Iheight(tm, r) + 1)
+        return IjoinRight(tm, l, k, r);
+    if (Iheight(tm, r) > Iheight(tm, l) + 1)
+        return IjoinLeft(tm, l, k, r);
+    ab(tm, k)->left = l;
+    ab(tm, k)->right = r;
+    ab(tm, k)->height = IgetTreeNodeHeight(tm, k);
+    return k;
+}
+
+/*
+ * l is higher than r: walk down the right spine of l, until a sub-tree of about the height of r is found
+ */
+static UL IjoinRight(TreeMap *tm, UL l, UL k, UL r) {
+    if (Iheight(tm, l) <= Iheight(tm, r) + 1) {
+        ab(tm, k)->left = l;
+        ab(tm, k)->right = r;
+        ab(tm, k)->height = IgetTreeNodeHeight(tm, k);
+        return k;
+    }
+    ab(tm, l)->right = IjoinRight(tm, ab(tm, l)->right, k, r);
+    ab(tm, l)->height = IgetTreeNodeHeight(tm, l);
+    return IbalanceTree(tm, l);
+}
+
+static UL IjoinLeft(TreeMap *tm, UL l, UL k, UL r) {
+    if (Iheight(tm, r) <= Iheight(tm, l) + 1) {
+        ab(tm, k)->left = l;
+        ab(tm, k)->right = r;
+        ab(tm, k)->height = IgetTreeNodeHeight(tm, k);
+        return k;
+    }
+    ab(tm, r)->left = IjoinLeft(tm, l, k, ab(tm, r)->left);
+    ab(tm, r)->height = IgetTreeNodeHeight(tm, r);
+    return IbalanceTree(tm, r);
+}
+
+/*
+ * Join two trees without a glue node: the smallest node of r is taken out and used as glue
+ */
+static UL IjoinTrees(TreeMap *tm, UL l, UL r) {
+    if (r == 0)
+        return l;
+    UL min;
+    r = IsplitMin(tm, r, &min);
+    return Ijoin(tm, l, min, r);
+}
+
+/*
+ * Take the smallest node out of the (sub-) tree n without freeing it. Returns the new root of the sub-tree.
+ */
+static UL IsplitMin(TreeMap *tm, UL n, UL *min) {
+    if (ab(tm, n)->left == 0) {
+        *min = n;
+        return ab(tm, n)->right;
+    }
+    ab(tm, n)->left = IsplitMin(tm, ab(tm, n)->left, min);
+    ab(tm, n)->height = IgetTreeNodeHeight(tm, n);
+    return IbalanceTree(tm, n);
+}
+
+/*
+ * Split the tree n into two balanced trees l (keys smaller than key) and r (keys larger than key). If the key itself
+ * is in the tree, it ends up in l if keyToLeft is set, otherwise in r.
+ */
+static void Isplit(TreeMap *tm, UL n, char *key, int keyToLeft, UL *l, UL *r) {
+    if (n == 0) {
+        *l = *r = 0;
+        return;
+    }
+    UL left = ab(tm, n)->left;
+    UL right = ab(tm, n)->right;
+    int cmp = strcmp(key, ab(tm, n)->key);
+    if (cmp > 0 || (cmp == 0 && keyToLeft)) { // n and its left sub-tree belong to l
+        UL splitLeft;
+        Isplit(tm, right, key, keyToLeft, &splitLeft, r);
+        *l = Ijoin(tm, left, n, splitLeft);
+    } else { // n and its right sub-tree belong to r
+        UL splitRight;
+        Isplit(tm, left, key, keyToLeft, l, &splitRight);
+        *r = Ijoin(tm, splitRight, n, right);
+    }
+}
+
+/*
+ * Give all nodes of a (sub-) tree, which is not part of the tree anymore, back to the pool and remove them from the
+ * hash index. Returns the number of removed nodes.
+ */
+static int IremoveSubTree(TreeMap *tm, UL n) {
+    if (n == 0)
+        return 0;
+    int count = IremoveSubTree(tm, ab(tm, n)->left) + IremoveSubTree(tm, ab(tm, n)->right);
+    if (IhashEnabled(tm))
+        IhashRemove(tm, ab(tm, n)->key);
+    Ifree_node(tm, n);
+    return count + 1;
+}
+
+static void IvisitSubTree(IParallelJob *job, UL n, void *acc) {
+    TreeMap *tm = job->tm;
+    while (n != 0) {
+        IvisitSubTree(job, ab(tm, n)->left, acc);
+        if (job->each != NULL)
+            job->each(ab(tm, n)->key, &(ab(tm, n)->value), job->ctx);
+        else
+            job->reduce(ab(tm, n)->key, &(ab(tm, n)->value), acc, job->ctx);
+        n = ab(tm, n)->right;
+    }
+}
+
+/*
+ * The nodes above the given depth are visited directly (by the calling thread), the sub-trees at this depth become
+ * the tasks for the threads
+ */
+static void IcollectTasks(IParallelJob *job, UL n, int depth, void *acc) {
+    if (n == 0)
+        return;
+    if (depth == 0) {
+        job->tasks[job->numTasks++] = n;
+        return;
+    }
+    IcollectTasks(job, ab(job->tm, n)->left, depth - 1, acc);
+    // Visit only the node itself, not its sub-trees
+    if (job->each != NULL)
+        job->each(ab(job->tm, n)->key, &(ab(job->tm, n)->value), job->ctx);
+    else
+        job->reduce(ab(job->tm, n)->key, &(ab(job->tm, n)->value), acc, job->ctx);
+    IcollectTasks(job, ab(job->tm, n)->right, depth - 1, acc);
+}
+
+static void *IparallelWorker(void *arg) {
+    IParallelWorker *worker = arg;
+    IParallelJob *job = worker->job;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int task = job->nextTask++;
+        pthread_mutex_unlock(&job->lock);
+        if (task >= job->numTasks)
+            break;
+        IvisitSubTree(job, job->tasks[task], worker->acc);
+    }
+    return NULL;
+}
+
+static int IrunParallel(TreeMap *tm, tm_forEachCallback each, tm_reduceCallback reduce, tm_combineCallback combine,
+                        void *acc, size_t accSize, void *ctx, int numThreads) {
+    if (numThreads < 1)
+        numThreads = 1;
+    // Use a few more sub-trees than threads, so that the work is distributed evenly
+    int depth = 0, height = tm_getHeight(tm);
+    while ((1 << depth) < 8 * numThreads && depth < height - 1)
+        depth++;
+
+    IParallelJob job = {tm, each, reduce, ctx, NULL, 0, 0};
+    IParallelWorker *workers = calloc(numThreads, sizeof(IParallelWorker));
+    char *accs = accSize > 0 ? malloc(accSize * numThreads) : NULL;
+    job.tasks = malloc(sizeof(UL) << depth);
+    if (workers == NULL || job.tasks == NULL || (accSize > 0 && accs == NULL)) {
+        fprintf(stderr, "Could not allocate memory for the threads: %s, line %d\n", __FILE__, __LINE__);
+        free(workers), free(accs), free(job.tasks);
+        return -1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+
+    // The calling thread is worker 0 and accumulates directly into acc, all others into a copy of the neutral element
+    for (int i = 0; i < numThreads; i++) {
+        workers[i].job = &job;
+        workers[i].acc = acc;
+        if (accSize > 0 && i > 0) {
+            workers[i].acc = accs + accSize * i;
+            memcpy(workers[i].acc, acc, accSize);
+        }
+    }
+    IcollectTasks(&job, tm->treeNodePool[0].left, depth, acc);
+
+    for (int i = 1; i < numThreads; i++)
+        workers[i].started = pthread_create(&workers[i].thread, NULL, IparallelWorker, &workers[i]) == 0;
+    IparallelWorker(&workers[0]); // if some thread could not be started, the others take over its tasks
+    for (int i = 1; i < numThreads; i++) {
+        if (workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+        if (combine != NULL)
+            combine(acc, workers[i].acc, ctx);
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    free(workers);
+    free(accs);
+    free(job.tasks);
+    return 0;
+}
+
+static size_t IroundToHugePages(size_t size) {
+    return (size + TM_HUGE_PAGE_SIZE - 1) / TM_HUGE_PAGE_SIZE * TM_HUGE_PAGE_SIZE;
+}
+
+/*
+ * Map size bytes of anonymous memory. If no explicit huge pages are available, TM_POOL_HUGE_PAGES in flags is replaced
+ * by TM_POOL_TRANSPARENT_HUGE_PAGES.
+ */
+static void *ImapPool(size_t size, int *flags) {
+    void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (*flags & TM_POOL_HUGE_PAGES) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED)
+            printf("No huge pages available, using transparent huge pages instead.\n");
+    }
+#endif
+    if (ptr == MAP_FAILED) {
+        if (*flags & TM_POOL_HUGE_PAGES)
+            *flags = (*flags & ~TM_POOL_HUGE_PAGES) | TM_POOL_TRANSPARENT_HUGE_PAGES;
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (ptr == MAP_FAILED) {
+        fprintf(stderr, "Could not map memory for the pool: %s, line %d\n", __FILE__, __LINE__);
+        return NULL;
+    }
+    return ptr;
+}
+
+/*
+ * Apply the huge page and NUMA settings (flags) to a (not yet touched) part of the pool. Failures are not fatal, the
+ * pool is then just backed by normal pages or allocated on the local node.
+ */
+static void IadvisePool(void *ptr, size_t size, int flags, int numaNode) {
+    if (size == 0)
+        return;
+#ifdef MADV_HUGEPAGE
+    if ((flags & TM_POOL_TRANSPARENT_HUGE_PAGES) && madvise(ptr, size, MADV_HUGEPAGE) != 0)
+        printf("Transparent huge pages not available.\n");
+#endif
+#ifdef SYS_mbind
+    if (flags & (TM_POOL_NUMA_BIND | TM_POOL_NUMA_INTERLEAVE)) {
+        // Not using libnuma here, so define the memory policies of <numaif.h> ourselves
+        const int mpolBind = 2, mpolInterleave = 3;
+        unsigned long nodeMask = 0;
+        int mode = mpolBind;
+        if (flags & TM_POOL_NUMA_INTERLEAVE) {
+            // Interleave over all online nodes, given as a list of ranges, e.g. "0-1,3"
+            mode = mpolInterleave;
+            FILE *file = fopen("/sys/devices/system/node/online", "r");
+            int from, to;
+            char sep = ',';
+            while (file != NULL && sep == ',' && fscanf(file, "%d", &from) == 1) {
+                to = from;
+                if (fscanf(file, "%c", &sep) == 1 && sep == '-' && fscanf(file, "%d%c", &to, &sep) < 1)
+                    break;
+                for (int i = from; i <= to && i < (int) (8 * sizeof(nodeMask)); i++)
+                    nodeMask |= 1UL << i;
+            }
+            if (file != NULL)
+                fclose(file);
+            if (nodeMask == 0)
+                nodeMask = 1; // no information about the nodes, so assume there is only one
+        } else if (numaNode >= 0 && numaNode < (int) (8 * sizeof(nodeMask))) {
+            nodeMask = 1UL << numaNode;
+        }
+        if (nodeMask == 0 || syscall(SYS_mbind, ptr, size, mode, &nodeMask, 8 * sizeof(nodeMask) + 1, 0) != 0)
+            printf("Could not apply the NUMA policy to the pool.\n");
+    }
+#endif
+}
+
+static ssize_t IfdWrite(void *ctx, const void *buf, size_t len) {
+    ssize_t ret;
+    do {
+        ret = write(*(int *) ctx, buf, len);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+static ssize_t IfdRead(void *ctx, void *buf, size_t len) {
+    ssize_t ret;
+    do {
+        ret = read(*(int *) ctx, buf, len);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
 /*
 void testTreeMap() {
     char shm_name[] = "ServerRasp-SHM";
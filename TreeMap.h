@@ -5,9 +5,34 @@
 #define BS1_TREEMAP_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #define MAX_KEYLENGTH 20
 
+// The (optional) hash index has at least this many slots for every node of the pool
+#define TM_HASH_SLOTS_PER_NODE 2
+
+// Flags stored in the first node of the pool (height), so that all processes sharing the pool see them
+#define TM_FLAG_HASH_INDEX 1
+
+// Bookkeeping data of the pool, stored as 32 bit numbers in the (otherwise unused) key of the first node
+#define TM_INFO_UNTOUCHED 0 // first untouched node (see tm_clear()), 0 if none
+#define TM_INFO_HASH_START 1 // first node of the region holding the hash index
+#define TM_INFO_HASH_NODES 2 // number of nodes of this region
+
+// Flags for tm_createTreeNodePool()
+#define TM_POOL_HUGE_PAGES 1 // explicit huge pages (MAP_HUGETLB), falls back to transparent huge pages if none reserved
+#define TM_POOL_TRANSPARENT_HUGE_PAGES 2 // ask the kernel to back the pool with transparent huge pages
+#define TM_POOL_NUMA_BIND 4 // allocate all memory of the pool on a single NUMA node
+#define TM_POOL_NUMA_INTERLEAVE 8 // spread the memory of the pool over all online NUMA nodes
+
+// Pools created with tm_createTreeNodePool() always have a multiple of this size
+#define TM_HUGE_PAGE_SIZE (2UL << 20)
+
+// Size of the internal buffers used when streaming a tree to/from a file descriptor or callback
+#define TM_STREAM_BUFSIZE 65536
+
 typedef unsigned long UL;
 
 //typedef struct TreeNode TreeNode;
@@ -23,8 +48,32 @@ typedef struct TreeMap {
     TreeNode *treeNodePool;
     unsigned int size_treeNodePool; // Initial Number of Tree-Nodes. INITIAL_POOL_SIZE
     size_t value_size;
+    // Only used for pools created with tm_createTreeNodePool()
+    size_t alloc_size;
+    int alloc_flags;
+    int numa_node;
 } TreeMap;
 
+/*
+ * Callbacks for tm_export()/tm_import(). They follow the semantics of write(2)/read(2): return the number of bytes
+ * processed (which may be less than len), 0 at the end of the stream (read only) or -1 on error.
+ */
+typedef ssize_t (*tm_writeCallback)(void *ctx, const void *buf, size_t len);
+
+typedef ssize_t (*tm_readCallback)(void *ctx, void *buf, size_t len);
+
+/*
+ * Callbacks for tm_parallelForEach()/tm_parallelReduce(). They are called concurrently from several threads and get
+ * references to the key and value stored in the tree. The value may be modified in place, the key must not be changed.
+ * tm_reduceCallback accumulates into the accumulator of the calling thread, tm_combineCallback merges the accumulator
+ * of another thread (other) into acc.
+ */
+typedef void (*tm_forEachCallback)(char *key, void *value, void *ctx);
+
+typedef void (*tm_reduceCallback)(char *key, void *value, void *acc, void *ctx);
+
+typedef void (*tm_combineCallback)(void *acc, void *other, void *ctx);
+
 /*
  * These functions starting with tm_ should be used to manipulate/access the tree
  *
@@ -45,10 +94,37 @@ int tm_poolExhausted(TreeMap *tm);
 
 void tm_resizeTreeNodePool(TreeMap *tm, void *new_ptr, size_t new_size, int re_init);
 
+void *tm_createTreeNodePool(TreeMap *tm, size_t size, size_t sizeSingleNode, int flags, int numaNode);
+
+void *tm_growTreeNodePool(TreeMap *tm, size_t new_size);
+
+void tm_destroyTreeNodePool(TreeMap *tm);
+
 int tm_getKeys(TreeMap *tm, char (*keys)[MAX_KEYLENGTH]);
 
 int tm_countNodes(TreeMap *tm);
 
+void tm_clear(TreeMap *tm);
+
+int tm_deleteRange(TreeMap *tm, char *from, char *to);
+
+int tm_parallelForEach(TreeMap *tm, tm_forEachCallback each, void *ctx, int numThreads);
+
+int tm_parallelReduce(TreeMap *tm, tm_reduceCallback reduce, tm_combineCallback combine, void *acc, size_t accSize,
+                      void *ctx, int numThreads);
+
+int tm_enableHashIndex(TreeMap *tm);
+
+void tm_disableHashIndex(TreeMap *tm);
+
+int tm_export(TreeMap *tm, tm_writeCallback write_cb, void *ctx);
+
+int tm_exportToFd(TreeMap *tm, int fd);
+
+int tm_import(TreeMap *tm, tm_readCallback read_cb, void *ctx);
+
+int tm_importFromFd(TreeMap *tm, int fd);
+
 static size_t sizeOfNode(TreeMap *tm);
 
 static TreeNode *ab(TreeMap *tm, UL rel);
@@ -81,4 +157,64 @@ static UL IdeleteTreeNode(TreeMap *tm, UL n, char *key);
 
 static int IcountTreeNodes(TreeMap *tm, UL n);
 
+static void IfreeSubTree(TreeMap *tm, UL n);
+
+static UL IgetPoolInfo(TreeMap *tm, int field);
+
+static void IsetPoolInfo(TreeMap *tm, int field, UL value);
+
+static UL IpoolEnd(TreeMap *tm);
+
+static void IlinkFreeNodes(TreeMap *tm, UL from, UL to);
+
+static UL Ijoin(TreeMap *tm, UL l, UL k, UL r);
+
+static UL IjoinRight(TreeMap *tm, UL l, UL k, UL r);
+
+static UL IjoinLeft(TreeMap *tm, UL l, UL k, UL r);
+
+static UL IjoinTrees(TreeMap *tm, UL l, UL r);
+
+static UL IsplitMin(TreeMap *tm, UL n, UL *min);
+
+static void Isplit(TreeMap *tm, UL n, char *key, int keyToLeft, UL *l, UL *r);
+
+static int IremoveSubTree(TreeMap *tm, UL n);
+
+static size_t IroundToHugePages(size_t size);
+
+static void *ImapPool(size_t size, int *flags);
+
+static void IadvisePool(void *ptr, size_t size, int flags, int numaNode);
+
+static int IhashEnabled(TreeMap *tm);
+
+static UL IhashTableNodes(TreeMap *tm, UL numNodes);
+
+static UL IhashNumSlots(TreeMap *tm);
+
+static UL IhashGet(TreeMap *tm, UL s);
+
+static void IhashSet(TreeMap *tm, UL s, UL n);
+
+static UL IhashHome(TreeMap *tm, char *key);
+
+static UL IhashFind(TreeMap *tm, char *key);
+
+static void IhashInsert(TreeMap *tm, UL n);
+
+static int IhashRemove(TreeMap *tm, char *key);
+
+static void IhashRelocate(TreeMap *tm, UL from, UL to);
+
+static void IhashRebuild(TreeMap *tm);
+
+static void IhashInsertSubTree(TreeMap *tm, UL n);
+
+static int IreserveNodes(TreeMap *tm, UL limit);
+
+static void ImarkSubTree(TreeMap *tm, UL n, char *live);
+
+static UL IrelocateSubTree(TreeMap *tm, UL n, UL limit);
+
 #endif //BS1_TREEMAP_H
@@ -1,5 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 #include "TreeMap.h"
 
 typedef struct {
@@ -10,9 +18,30 @@ typedef struct {
 
 void example1();
 
-int main() {
+void example4();
+
+void example5();
+
+void example6();
+
+void example7();
+
+/*
+ * Runs all examples. The benchmark (example 6) takes a while and is only run with the argument "benchmark".
+ */
+int main(int argc, char **argv) {
     printf("Running Example 1!\n");
     example1();
+    printf("\n\nRunning Example 4!\n");
+    example4();
+    printf("\n\nRunning Example 5!\n");
+    example5();
+    if (argc > 1 && strcmp(argv[1], "benchmark") == 0) {
+        printf("\n\nRunning Example 6!\n");
+        example6();
+    }
+    printf("\n\nRunning Example 7!\n");
+    example7();
     return 0;
 }
 
@@ -124,4 +153,353 @@ void example1() {
      * Remember to free the memory, obtained with malloc()
      */
     free(ptr);
-}
\ No newline at end of file
+}
+
+/*
+ * This example exports a tree with many deleted entries to a file and loads it into a second, smaller tree again.
+ * Only the live entries are written, so the second pool only needs to be as large as the number of entries.
+ */
+void example4() {
+    const int numNodes = 1000;
+    size_t nodeSize = sizeof(MyNode);
+    int memSize = tm_estimateRequiredBytes(nodeSize, numNodes);
+    void *ptr = malloc(memSize);
+    if (ptr == NULL)
+        perror("Error in malloc"), exit(EXIT_FAILURE);
+    TreeMap tm;
+    tm_initTreeNodePool(&tm, ptr, memSize, nodeSize);
+
+    /*
+     * Insert 1000 elements and delete all but every 10th element again
+     */
+    char key[MAX_KEYLENGTH];
+    MyNode template;
+    for (int i = 0; i < numNodes; i++) {
+        sprintf(key, "%d", i);
+        sprintf(template.bookAuthor, "Markus %d", i);
+        tm_insert(&tm, key, &template);
+    }
+    for (int i = 0; i < numNodes; i++) {
+        if (i % 10 == 0) continue;
+        sprintf(key, "%d", i);
+        tm_delete(&tm, key);
+    }
+
+    /*
+     * Export the remaining elements to a temporary file
+     */
+    FILE *file = tmpfile();
+    if (file == NULL)
+        perror("Error in tmpfile"), exit(EXIT_FAILURE);
+    int numExported = tm_exportToFd(&tm, fileno(file));
+    printf("\nExported %d elements (file size: %ld bytes, pool size: %d bytes)\n", numExported,
+           lseek(fileno(file), 0, SEEK_CUR), memSize);
+
+    /*
+     * And load them into a new tree, which has exactly the required capacity
+     */
+    int memSize2 = tm_estimateRequiredBytes(nodeSize, numExported);
+    void *ptr2 = malloc(memSize2);
+    if (ptr2 == NULL)
+        perror("Error in malloc"), exit(EXIT_FAILURE);
+    TreeMap tm2;
+    tm_initTreeNodePool(&tm2, ptr2, memSize2, nodeSize);
+    lseek(fileno(file), 0, SEEK_SET);
+    int numImported = tm_importFromFd(&tm2, fileno(file));
+    fclose(file);
+    printf("\nImported %d elements. Height of the new tree: %d\n", numImported, tm_getHeight(&tm2));
+
+    MyNode value;
+    int errorFlag = numImported != numExported;
+    for (int i = 0; i < numNodes; i += 10) {
+        sprintf(key, "%d", i);
+        sprintf(template.bookAuthor, "Markus %d", i);
+        if (tm_getValue(&tm2, key, &value) == NULL || strcmp(value.bookAuthor, template.bookAuthor) != 0) {
+            fprintf(stderr, "ERROR. Should have found the key %s in the tree: %s, line %d\n", key, __FILE__, __LINE__);
+            errorFlag = 1;
+        }
+    }
+    if (errorFlag == 0)
+        printf("Successfully found all exported elements in the new tree!\n");
+
+    free(ptr);
+    free(ptr2);
+}
+
+/*
+ * Count the entries of a tree, whose author ends with the digit given in ctx
+ */
+static void countAuthors(char *key, void *value, void *acc, void *ctx) {
+    MyNode *node = value;
+    size_t len = strlen(node->bookAuthor);
+    if (len > 0 && node->bookAuthor[len - 1] == *(char *) ctx)
+        (*(int *) acc)++;
+}
+
+static void sumCounts(void *acc, void *other, void *ctx) {
+    *(int *) acc += *(int *) other;
+}
+
+/*
+ * This example shows the operations working on the whole tree (or larger parts of it) at once: aggregating over all
+ * entries with several threads, deleting a range of keys and clearing the tree.
+ */
+void example5() {
+    const int numNodes = 10000;
+    size_t nodeSize = sizeof(MyNode);
+    int memSize = tm_estimateRequiredBytes(nodeSize, numNodes);
+    void *ptr = malloc(memSize);
+    if (ptr == NULL)
+        perror("Error in malloc"), exit(EXIT_FAILURE);
+    TreeMap tm;
+    tm_initTreeNodePool(&tm, ptr, memSize, nodeSize);
+
+    char key[MAX_KEYLENGTH];
+    MyNode template;
+    for (int i = 0; i < numNodes; i++) {
+        sprintf(key, "%05d", i); // with leading zeros, so that the order of the keys matches the order of the numbers
+        sprintf(template.bookAuthor, "Markus %d", i);
+        tm_insert(&tm, key, &template);
+    }
+
+    /*
+     * Count all authors ending with 7, using 4 threads. The accumulator has to be initialized with 0.
+     */
+    int count = 0;
+    char digit = '7';
+    tm_parallelReduce(&tm, countAuthors, sumCounts, &count, sizeof(count), &digit, 4);
+    printf("\nNumber of authors ending with %c: %d (expected: %d)\n", digit, count, numNodes / 10);
+
+    /*
+     * Delete the keys 01000-05999 at once
+     */
+    int numDeleted = tm_deleteRange(&tm, "01000", "05999");
+    printf("Deleted %d elements. Number of nodes: %d, height of the tree: %d\n", numDeleted, tm_countNodes(&tm),
+           tm_getHeight(&tm));
+
+    /*
+     * Remove all remaining elements
+     */
+    tm_clear(&tm);
+    printf("After clearing the tree: number of nodes: %d, pool exhausted: %d\n", tm_countNodes(&tm),
+           tm_poolExhausted(&tm));
+
+    /*
+     * The cleared pool can be resized and used again: Double its size and fill it completely.
+     * Every key must be found again and the pool has to report that it is exhausted afterwards.
+     */
+    int memSize2 = tm_estimateRequiredBytes(nodeSize, 2 * numNodes);
+    void *ptr2 = realloc(ptr, memSize2);
+    if (ptr2 == NULL)
+        perror("Error in realloc"), exit(EXIT_FAILURE);
+    ptr = ptr2;
+    tm_resizeTreeNodePool(&tm, ptr, memSize2, 1);
+    int numInserted = 0;
+    while (!tm_poolExhausted(&tm)) {
+        sprintf(key, "%05d", numInserted++);
+        tm_insert(&tm, key, &template);
+    }
+    MyNode value;
+    int errorFlag = numInserted != 2 * numNodes || tm_countNodes(&tm) != numInserted;
+    for (int i = 0; i < numInserted; i++) {
+        sprintf(key, "%05d", i);
+        if (tm_getValue(&tm, key, &value) == NULL) {
+            fprintf(stderr, "ERROR. Should have found the key %s in the tree: %s, line %d\n", key, __FILE__, __LINE__);
+            errorFlag = 1;
+        }
+    }
+    printf("\nFilled the resized pool with %d elements.\n", numInserted);
+    if (errorFlag == 0)
+        printf("Successfully found all elements in the resized pool!\n");
+
+    free(ptr);
+}
+
+/*
+ * Open a counter for the data-TLB misses of this thread. Returns -1, if not supported (e.g., no permissions).
+ */
+static int openTlbMissCounter() {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Insert the keys 0 .. numNodes-1. If growPool is set, the pool (created with tm_createTreeNodePool()) is doubled
+ * whenever it is exhausted.
+ */
+static void insertBooks(TreeMap *tm, int numNodes, int growPool) {
+    char key[MAX_KEYLENGTH];
+    MyNode template;
+    memset(&template, 0, sizeof(template));
+    for (int i = 0; i < numNodes; i++) {
+        if (growPool && tm_poolExhausted(tm) && tm_growTreeNodePool(tm, 2 * tm->alloc_size) == NULL)
+            exit(EXIT_FAILURE);
+        sprintf(key, "%d", i);
+        sprintf(template.bookAuthor, "Markus %d", i);
+        tm_insert(tm, key, &template);
+    }
+}
+
+/*
+ * Look up random keys of a tree containing the keys 0 .. numNodes-1. Prints the time and the number of TLB misses.
+ */
+static void benchmarkLookups(TreeMap *tm, const char *name, int numNodes) {
+    char key[MAX_KEYLENGTH];
+    const int numLookups = 1000000;
+    int counter = openTlbMissCounter();
+    long long tlbMisses = -1;
+    struct timespec start, end;
+    srand(42);
+#ifdef __linux__
+    if (counter >= 0)
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0), ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    MyNode value;
+    for (int i = 0; i < numLookups; i++) {
+        sprintf(key, "%d", rand() % numNodes);
+        tm_getValue(tm, key, &value);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef __linux__
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &tlbMisses, sizeof(tlbMisses)) != sizeof(tlbMisses))
+            tlbMisses = -1;
+        close(counter);
+    }
+#endif
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("\n%-25s %d lookups in %.3f s, ", name, numLookups, seconds);
+    if (tlbMisses >= 0)
+        printf("dTLB misses: %lld\n", tlbMisses);
+    else
+        printf("dTLB misses: not available\n");
+}
+
+/*
+ * This example compares random lookups in a large tree, whose pool was obtained with malloc(), with a pool created by
+ * tm_createTreeNodePool() backed by huge pages (and interleaved over all NUMA nodes). The pool of the second tree
+ * starts small and is grown while inserting.
+ */
+void example6() {
+    const int numNodes = 500000;
+    size_t nodeSize = sizeof(MyNode);
+
+    size_t memSize = tm_estimateRequiredBytes(nodeSize, numNodes);
+    void *ptr = malloc(memSize);
+    if (ptr == NULL)
+        perror("Error in malloc"), exit(EXIT_FAILURE);
+    TreeMap tm;
+    tm_initTreeNodePool(&tm, ptr, memSize, nodeSize);
+    insertBooks(&tm, numNodes, 0);
+    benchmarkLookups(&tm, "malloc():", numNodes);
+    free(ptr);
+
+    TreeMap tm2;
+    if (tm_createTreeNodePool(&tm2, TM_HUGE_PAGE_SIZE, nodeSize, TM_POOL_HUGE_PAGES | TM_POOL_NUMA_INTERLEAVE, 0) == NULL)
+        exit(EXIT_FAILURE);
+    insertBooks(&tm2, numNodes, 1);
+    benchmarkLookups(&tm2, "tm_createTreeNodePool():", numNodes);
+    tm_destroyTreeNodePool(&tm2);
+}
+
+/*
+ * Check that exactly the keys i with expected[i] != 0 are found in the tree (keys are "%05d")
+ */
+static int checkKeys(TreeMap *tm, const char *expected, int numKeys) {
+    char key[MAX_KEYLENGTH];
+    MyNode value;
+    int errorFlag = 0;
+    for (int i = 0; i < numKeys; i++) {
+        sprintf(key, "%05d", i);
+        if ((tm_getValue(tm, key, &value) != NULL) != (expected[i] != 0)) {
+            fprintf(stderr, "ERROR. Wrong result for key %s: %s, line %d\n", key, __FILE__, __LINE__);
+            errorFlag = 1;
+        }
+    }
+    return errorFlag;
+}
+
+/*
+ * This example uses the hash index for exact lookups. The index is kept up to date while deleting single keys and
+ * ranges of keys, and grows with the pool.
+ */
+void example7() {
+    const int numNodes = 2000;
+    size_t nodeSize = sizeof(MyNode);
+    int memSize = tm_estimateRequiredBytes(nodeSize, numNodes);
+    void *ptr = malloc(memSize);
+    if (ptr == NULL)
+        perror("Error in malloc"), exit(EXIT_FAILURE);
+    TreeMap tm;
+    tm_initTreeNodePool(&tm, ptr, memSize, nodeSize);
+
+    /*
+     * Fill half of the tree first. Enabling the index moves the entries out of the nodes required for the index.
+     */
+    char key[MAX_KEYLENGTH];
+    char expected[2 * numNodes];
+    memset(expected, 0, sizeof(expected));
+    MyNode template;
+    memset(&template, 0, sizeof(template));
+    for (int i = 0; i < numNodes / 2; i++) {
+        sprintf(key, "%05d", i);
+        tm_insert(&tm, key, &template);
+        expected[i] = 1;
+    }
+    if (tm_enableHashIndex(&tm) != 0)
+        exit(EXIT_FAILURE);
+
+    /*
+     * Keep inserting until the pool is exhausted and then double its size. The index grows with the pool.
+     */
+    for (int i = numNodes / 2; i < 2 * numNodes; i++) {
+        if (tm_poolExhausted(&tm)) {
+            memSize *= 2;
+            void *new_ptr = realloc(ptr, memSize);
+            if (new_ptr == NULL)
+                perror("Error in realloc"), exit(EXIT_FAILURE);
+            ptr = new_ptr;
+            tm_resizeTreeNodePool(&tm, ptr, memSize, 1);
+        }
+        sprintf(key, "%05d", i);
+        tm_insert(&tm, key, &template);
+        expected[i] = 1;
+    }
+
+    /*
+     * Delete every third key (which moves nodes inside the tree and entries inside the index) and a range of keys
+     */
+    for (int i = 0; i < 2 * numNodes; i += 3) {
+        sprintf(key, "%05d", i);
+        tm_delete(&tm, key);
+        expected[i] = 0;
+    }
+    tm_deleteRange(&tm, "01000", "01999");
+    memset(expected + 1000, 0, 1000);
+
+    int errorFlag = checkKeys(&tm, expected, 2 * numNodes);
+    printf("\nNumber of nodes in the tree: %d, height of the tree: %d\n", tm_countNodes(&tm), tm_getHeight(&tm));
+
+    /*
+     * Without the index, the same keys have to be found by walking down the tree
+     */
+    tm_disableHashIndex(&tm);
+    errorFlag |= checkKeys(&tm, expected, 2 * numNodes);
+    if (errorFlag == 0)
+        printf("Successfully found all remaining elements with and without the hash index!\n");
+
+    free(ptr);
+}